@@ -1,17 +1,29 @@
 #ifndef BUF_H
 #define BUF_H
 
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 #include "db.h"
+#include "ioengine.h"
+#include "replacer.h"
 // define if debug output wanted
 //#define DEBUGBUF
 
-// declarations for buffer pool hash table
+// declarations for buffer pool hash table.  The table is a flat array
+// of these slots using open addressing (linear probing); a slot is
+// empty when file == NULL.  The fields are atomics only so that
+// lookupOptimistic may read them while a writer changes them; they are
+// accessed relaxed and ordered by the table's version.
 struct hashBucket
 {
-	File*	file;    // pointer a file object (more on this below)
-	int	pageNo;  // page number within a file
-	int	frameNo; // frame number of page in the buffer pool
-	hashBucket* 	next;	 // next node in the hash table
+	std::atomic<File*>	file;    // pointer a file object (more on this below)
+	std::atomic<int>	pageNo;  // page number within a file
+	std::atomic<int>	frameNo; // frame number of page in the buffer pool
 };
 
 
@@ -19,13 +31,34 @@ struct hashBucket
 class BufHashTbl
 {
 private:
-    int HTSIZE;
-    hashBucket**  ht; // actual hash table
+    int HTSIZE;       // always a power of two
+    std::atomic<unsigned int> mask;  // HTSIZE - 1
+    int shift;        // 64 - log2(HTSIZE), used by hash()
+    int numEntries;   // number of occupied slots
+    std::atomic<hashBucket*> ht; // actual hash table, HTSIZE inline slots
     int	 hash(const File* file, const int pageNo); // returns value between 0 and HTSIZE-1
+    void grow();      // double HTSIZE and rehash
+
+    // seqlock over the slots: odd while insert, remove or grow is
+    // changing them.  Writers are serialised by the caller's latch.
+    std::atomic<unsigned int> version;
+    void beginWrite();
+    void endWrite();
+
+    // slot arrays replaced by grow().  A lookupOptimistic may still be
+    // probing one, so they are only freed with the table.
+    std::vector<hashBucket*> retired;
+
+    // returns the slot holding (file,pageNo), or -1 if it is not present
+    int  find(const File* file, const int pageNo);
 
 public:
-    BufHashTbl(const int htSize);  // constructor
+    BufHashTbl(const int htSize);  // constructor, rounds htSize up to a power of two
     ~BufHashTbl(); // destructor
+
+    // 64-bit mixed hash of (file,pageNo); hash() keeps its top bits,
+    // BufMgr picks the page table partition from its middle bits
+  static uint64_t hashKey(const File* file, const int pageNo);
 	
     // insert entry into hash table mapping (file,pageNo) to frameNo;
     // returns 0 if OK, HASHTBLERROR if an error occurred
@@ -36,58 +69,304 @@ public:
     // HASHNOTFOUND
   Status lookup(const File* file, const int pageNo, int & frameNo);
 
+    // lookup without the caller's latch, for the hit path.  Never
+    // blocks writers: the probe is retried if insert, remove or grow
+    // ran meanwhile.  The frame returned may have been reused by the
+    // time the caller looks at it, so the caller must check its tag.
+  Status lookupOptimistic(const File* file, const int pageNo, int & frameNo) const;
+
     // delete entry (file,pageNo) from hash table. REturn OK if page was
     // found.  Else return HASHTBLERROR
   Status remove(const File* file, const int pageNo);  
+
+    // number of slots a lookup of (file,pageNo) examines, or -1 if the
+    // entry is not present.  Used by the hash micro-benchmark.
+  int probeLength(const File* file, const int pageNo);
+
+  int size() const { return HTSIZE; }
 };
 
 
 class BufMgr;  //forward declaration of BufMgr class 
 
-// class for maintaining information about buffer pool frames
+// Layout of the per-frame state word.  Everything the hit path and the
+// clock need to look at lives in one 64-bit atomic so that pinning,
+// unpinning (including marking the page dirty) and claiming a victim
+// are each a single compare-and-swap.
+const uint64_t BUF_PIN_MASK = 0xFFFFFFFFULL; // pin count, low 32 bits
+const uint64_t BUF_PIN_ONE  = 1ULL;
+const uint64_t BUF_REF      = 1ULL << 32;    // usage (clock reference) bit
+const uint64_t BUF_DIRTY    = 1ULL << 33;    // page differs from disk
+const uint64_t BUF_VALID    = 1ULL << 34;    // frame holds (file, pageNo)
+const uint64_t BUF_IO       = 1ULL << 35;    // frame claimed for I/O or replacement
+const uint64_t BUF_READING  = 1ULL << 36;    // read-ahead in flight, contents not there yet
+const uint64_t BUF_IOERR    = 1ULL << 37;    // read-ahead failed, frame being given back
+const uint64_t BUF_ONDIRTY  = 1ULL << 38;    // frame is on its file's dirty list
+const uint64_t BUF_LOADING  = 1ULL << 39;    // the read in flight is a readPage miss
+
+// the frames of one file, threaded through BufDesc.  The resident list
+// holds every frame mapped to the file and is only changed under
+// BufMgr::allocMutex.  The dirty list is a superset of the file's dirty
+// frames: unPinPage adds a frame the first time it is dirtied and
+// flushFiles prunes the clean ones, both under dirtyLatch.
+struct BufFileFrames
+{
+  int        resident;   // head of the resident list, -1 if empty
+  int        count;      // frames on the resident list
+  std::mutex dirtyLatch;
+  int        dirty;      // head of the dirty list, -1 if empty
+
+  BufFileFrames() : resident(-1), count(0), dirty(-1) {}
+};
+
+// class for maintaining information about buffer pool frames.
+//
+// file and pageNo (the frame's tag) only change while the frame is
+// claimed (BUF_IO set) under BufMgr::allocMutex.  A frame is mapped in
+// the page table exactly when BUF_VALID is set; both are changed
+// together under the page's partition latch.
 class BufDesc {
     friend class BufMgr;
+    friend class BufReplacer;
 private:
   File* file;   // pointer to file object
   int   pageNo; // page within file
   int	frameNo;  // frame # of frame
-  int   pinCnt; // number of times this page has been pinned
-  bool 	dirty;	  // true if dirty;  false otherwise
-  bool 	valid;   // true if page is valid
-  bool  refbit;	 // has this buffer frame been reference recently
+  std::atomic<uint64_t> state;  // pin count and flags, see BUF_*
+
+  // links on the file's frame lists, see BufFileFrames
+  BufFileFrames* lists;
+  int   residentPrev, residentNext;
+  int   dirtyPrev, dirtyNext;
+  bool  dirtyLinked;
+  bool  onFreeStack;  // listed on BufMgr::freeFrames; guarded by allocMutex
+
+  uint64_t pinCnt() const {  // number of times this page has been pinned
+      return state.load(std::memory_order_relaxed) & BUF_PIN_MASK;
+  }
+  bool dirty() const {  // true if dirty;  false otherwise
+      return state.load(std::memory_order_relaxed) & BUF_DIRTY;
+  }
+  bool valid() const {  // true if page is valid
+      return state.load(std::memory_order_relaxed) & BUF_VALID;
+  }
+
+  // pin a valid frame and set its reference bit; fails if the frame
+  // is no longer valid
+  bool pin() {
+      uint64_t s = state.load(std::memory_order_relaxed);
+      do {
+          if (!(s & BUF_VALID))
+              return false;
+      } while (!state.compare_exchange_weak(s, (s + BUF_PIN_ONE) | BUF_REF,
+                                            std::memory_order_acquire));
+      return true;
+  }
+
+  // drop one pin, marking the page dirty in the same step; fails if
+  // the frame is not pinned.  Sequentially consistent so the clock's
+  // pinned marks (read right after) cannot miss it
+  bool unpin(bool setDirty) {
+      uint64_t s = state.load(std::memory_order_relaxed);
+      do {
+          if (!(s & BUF_PIN_MASK))
+              return false;
+      } while (!state.compare_exchange_weak(s, (s - BUF_PIN_ONE) | (setDirty ? BUF_DIRTY : 0)));
+      return true;
+  }
+
+  // take exclusive ownership of an unpinned frame for write-back or
+  // replacement: CAS from the observed zero-pin state to one pin with
+  // BUF_IO set.  Fails if the frame is pinned, already claimed, or (when
+  // honourRef is set) was referenced since the last sweep.
+  bool claim(bool honourRef) {
+      uint64_t s = state.load(std::memory_order_relaxed);
+      do {
+          if ((s & (BUF_PIN_MASK | BUF_IO)) || (honourRef && (s & BUF_REF)))
+              return false;
+      } while (!state.compare_exchange_weak(s, s + BUF_PIN_ONE + BUF_IO,
+                                            std::memory_order_acquire));
+      return true;
+  }
+
+  // give up a claim without changing the frame's contents
+  void release() {
+      state.fetch_sub(BUF_PIN_ONE + BUF_IO, std::memory_order_release);
+  }
+
+  // pin without touching the reference bit (scan access); fails if
+  // the frame is no longer valid
+  bool pinNoRef() {
+      uint64_t s = state.load(std::memory_order_relaxed);
+      do {
+          if (!(s & BUF_VALID))
+              return false;
+      } while (!state.compare_exchange_weak(s, s + BUF_PIN_ONE,
+                                            std::memory_order_acquire));
+      return true;
+  }
+
+  // clear the reference bit; returns whether it was set
+  bool clearRef() {
+      return state.fetch_and(~BUF_REF, std::memory_order_relaxed) & BUF_REF;
+  }
+
+  // for a claimed frame, move from valid to invalid provided nobody
+  // else pinned or dirtied it since the claim
+  bool invalidate() {
+      uint64_t s = state.load(std::memory_order_relaxed);
+      do {
+          if ((s & BUF_PIN_MASK) != BUF_PIN_ONE || (s & BUF_DIRTY))
+              return false;
+      } while (!state.compare_exchange_weak(s, BUF_PIN_ONE | BUF_IO,
+                                            std::memory_order_acq_rel));
+      return true;
+  }
 
   void Clear() {  // initialize buffer frame for a new user
-    	pinCnt = 0;
 	file = NULL;
 	pageNo = -1;
-    	dirty = false;
-	valid = false;
+	state.store(0, std::memory_order_release);
   };
 
-  void Set(File* filePtr, int pageNum) { 
+  void Set(File* filePtr, int pageNum, bool ref = true) { 
+      file = filePtr;
+      pageNo = pageNum;
+      state.store(BUF_PIN_ONE | BUF_VALID | (ref ? BUF_REF : 0),
+                  std::memory_order_release);
+  }
+
+  // map a claimed frame to a page whose read is in flight, either
+  // read-ahead or (loading) a readPage miss done by the claimer itself.
+  // Hits may pin it but must wait for BUF_READING to clear.
+  void SetReading(File* filePtr, int pageNum, bool loading = false) {
       file = filePtr;
       pageNo = pageNum;
-      pinCnt = 1;
-      dirty = false;
-      valid = true;
-      refbit = true;
+      state.store(BUF_PIN_ONE | BUF_IO | BUF_VALID | BUF_READING |
+                  (loading ? BUF_LOADING : 0), std::memory_order_release);
+  }
+
+  // the read landed: drop the reader's claim, publishing the contents
+  void finishRead() {
+      state.fetch_sub(BUF_PIN_ONE + BUF_IO + BUF_READING, std::memory_order_release);
+  }
+
+  // a readPage miss landed: publish the contents, turning the claim
+  // into the loader's pin
+  void finishLoad(bool ref) {
+      uint64_t s = state.load(std::memory_order_relaxed);
+      while (!state.compare_exchange_weak(s, ((s & ~(BUF_IO | BUF_READING | BUF_LOADING)) |
+                                              (ref ? BUF_REF : 0))))
+          ;
+  }
+
+  // the read failed: unmap (the caller removes the page table entry)
+  // and flag the error for pinned waiters; the claim is kept until
+  // BufMgr hands the frame back to the replacement policy
+  void failRead() {
+      uint64_t s = state.load(std::memory_order_relaxed);
+      while (!state.compare_exchange_weak(s, (s & ~(BUF_VALID | BUF_READING | BUF_LOADING)) | BUF_IOERR))
+          ;
   }
 
   BufDesc() {
+      frameNo = -1;
+      lists = NULL;
+      residentPrev = residentNext = -1;
+      dirtyPrev = dirtyNext = -1;
+      dirtyLinked = false;
+      onFreeStack = false;
       Clear();
   }
 };
 
 
+// one lock-striped partition of the page table.  The latch serialises
+// the partition's writers; hits do not take it (see lookupOptimistic).
+// Aligned to a cache line so that partitions do not share lines.
+struct alignas(64) BufPartition
+{
+  std::mutex  latch;
+  BufHashTbl* table;
+};
+
+const int BUFPARTITIONS = 16;  // number of page table partitions (power of 2)
+
+// readPage hits, striped by thread so that hits from different cores
+// do not share a cache line
+struct alignas(64) BufHitCounter
+{
+  std::atomic<int> hits;
+};
+
+const int BUFHITSTRIPES = 64;  // number of hit counters (power of 2)
+
+
+// access-strategy hints for readPage/allocPage
+enum BufAccess
+{
+  ACCESS_NORMAL,     // page competes in the replacement policy as usual
+  ACCESS_SEQSCAN,    // large sequential read: recycle a small ring of frames
+  ACCESS_BULKWRITE   // bulk load / rewrite: recycle a larger ring of frames
+};
+
+// Per-scan state for a non-normal access strategy.  Pages read or
+// allocated through a strategy are loaded without their reference bit
+// and into a small private ring of frames: once the ring is full, the
+// next miss reuses the ring's oldest frame (writing it back first if
+// the caller dirtied it) instead of asking the replacement policy, so a
+// large scan evicts at most ring-size pages of everyone else's working
+// set.  A ring frame is only reused if it still holds the page we put
+// there and nobody else has pinned or referenced it since.
+//
+// A BufStrategy belongs to one scan and must not be shared between
+// threads.  With a sharded BufMgr each shard gets a ring of its own.
+class BufStrategy
+{
+  friend class BufMgr;
+public:
+  BufStrategy(const BufAccess access);
+  ~BufStrategy();
+
+  BufAccess getAccess() const { return access; }
+
+private:
+  struct Slot { int frame; const File* file; int pageNo; };
+
+  BufAccess access;
+  int       size;      // ring capacity in frames
+  int       current;   // slot used by the last miss
+  Slot*     ring;
+
+  // for a sharded BufMgr: the per-shard strategies, made on first use,
+  // and for one of those the strategy it belongs to
+  std::vector<BufStrategy*> shardRings;
+  BufStrategy* whole;
+
+  BufStrategy(const BufStrategy&);             // not copyable
+  BufStrategy& operator=(const BufStrategy&);
+};
+
+const int SEQSCAN_RING = 32;     // ring size for ACCESS_SEQSCAN, in frames
+const int BULKWRITE_RING = 128;  // ring size for ACCESS_BULKWRITE, in frames
+
+const int READAHEAD_WINDOW = 32;  // pages read ahead of a sequential reader
+const int READAHEAD_AUTO = -1;    // READAHEAD_WINDOW with io_uring, off otherwise
+const int READAHEAD_TRIGGER = 4;  // ascending reads before read-ahead starts
+
+
 struct BufStats
 {
-  int accesses;    // Total number of accesses to buffer pool
-  int diskreads;   // Number of pages read from disk (including allocs)
-  int diskwrites;  // Number of pages written back to disk
+  std::atomic<int> accesses;    // Total number of accesses to buffer pool
+  std::atomic<int> diskreads;   // Number of pages read from disk (including allocs)
+  std::atomic<int> diskwrites;  // Number of pages written back to disk
+  std::atomic<int> fgwrites;    // dirty victims written by the thread that needed the frame
+  std::atomic<int> bgwrites;    // pages cleaned ahead of time by the background writer
+  std::atomic<int> prefetched;  // pages read ahead of their readPage (part of diskreads)
 
   void clear()
     {
-      accesses = diskreads = diskwrites = 0;
+      accesses = diskreads = diskwrites = fgwrites = bgwrites = prefetched = 0;
     }
       
   BufStats()
@@ -97,45 +376,267 @@ struct BufStats
 };
 
 
+// how bufPool is backed
+enum BufMemory {
+  MEM_HEAP,      // heap, aligned to DIRECTIO_ALIGN
+  MEM_THP,       // anonymous mmap advised MADV_HUGEPAGE (transparent huge pages)
+  MEM_HUGETLB    // mmap MAP_HUGETLB from the reserved pool; falls back to MEM_THP
+};
+
+const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;  // x86-64/arm64 default huge page
+
+// construction-time options for BufMgr
+struct BufConfig
+{
+  BufPolicy    policy;        // replacement policy
+  IOEngineKind ioEngine;      // backend for batched write-back
+  int          ioDepth;       // requests the engine keeps in flight
+  bool         fixedBuffers;  // register bufPool with the engine
+  int          readAhead;     // sequential read-ahead window in pages, 0 = off,
+                              // READAHEAD_AUTO = on only if the engine is io_uring
+  BufMemory    memory;        // backing of bufPool
+  int          numaNodes;     // > 0: split bufPool into this many ranges,
+                              // range i bound to NUMA node i (mmap modes only)
+  int          shards;        // > 1: split the pool into this many independent
+                              // shards, pages routed by hash of (file, pageNo)
+
+  explicit BufConfig(const BufPolicy policy = POLICY_CLOCK)
+    : policy(policy), ioEngine(IO_POSIX), ioDepth(64),
+      fixedBuffers(false), readAhead(READAHEAD_AUTO),
+      memory(MEM_HEAP), numaNodes(0), shards(1) {}
+};
+
+
 class BufMgr 
 {
 private:
-  unsigned int 	 clockHand;
   int   	 numBufs;    	// Number of pages in buffer pool
-  BufHashTbl*    hashTable;  	// hash table mapping (File, page) to frame
+  BufPartition*  partitions;  	// page table mapping (File, page) to frame
   BufDesc*	 bufTable;  	// vector of status info, 1 per page
-  BufStats	 bufStats;	// buffer pool statistics
+  BufReplacer*   replacer;	// replacement policy
+  mutable BufStats bufStats;	// buffer pool statistics
+  BufHitCounter  hitCounters[BUFHITSTRIPES];  // folded into bufStats.accesses
 
-  const Status allocBuf(int & frame);   // allocate a free frame.  
-  const void releaseBuf(int frame); // return unused frame to end of list
-  void advanceClock()
+  // serialises frame replacement, page loads and file-level operations
+  // (allocPage, disposePage, flushFile).  Never taken on a hit.
+  std::mutex	 allocMutex;
+
+  // batched page I/O.  ioEngine is used under allocMutex (flushFile,
+  // the destructor), bgEngine only by the background writer, raEngine
+  // for read-ahead under raMutex; each has one request slot per frame.
+  IOEngine*	 ioEngine;
+  IOEngine*	 bgEngine;
+  IOEngine*	 raEngine;
+  IORequest*	 ioReqs;
+  IORequest*	 bgReqs;
+  IORequest*	 raReqs;        // indexed by frame
+  IORequest**	 ioDone;        // scratch for reap(), used with ioEngine
+  IORequest**	 bgDone;        // scratch for reap(), used with bgEngine
+  IORequest**	 raDone;        // scratch for reap(), used with raEngine
+
+  // read-ahead.  Completions are reaped by whichever thread needs one
+  // of the pages (or a frame) first.  raMutex may be taken under
+  // allocMutex, never the other way round.
+  int		 readAheadWindow;
+  std::mutex	 raMutex;
+  std::atomic<int> raBusy;       // frames claimed by read-ahead or readPage misses
+  std::vector<int> raFailed;     // failed reads awaiting reclaimFailedReads
+
+  // readPage misses read outside allocMutex.  Hits on a page being
+  // loaded wait on loadDone for its BUF_READING to clear.
+  std::mutex	 loadMutex;
+  std::condition_variable loadDone;
+  std::atomic<int> loadWaiters;
+  void  wakeLoadWaiters();
+
+  void  reapReads(const int minComplete);  // caller holds raMutex
+  void  reclaimFailedReads();    // caller holds allocMutex
+
+  // per-file frame lists, so that flushing a file costs in proportion
+  // to its frames rather than to the pool.  Guarded by allocMutex.
+  std::unordered_map<const File*, BufFileFrames> fileFrames;
+
+  // frames left empty (at construction, by flushFile and disposePage,
+  // by failed reads and failed mappings), most recent on top.  It is
+  // the only record of free frames: the list-based policies track only
+  // frames holding pages.  At most one entry per frame (onFreeStack);
+  // entries may be stale (the clock can reuse a frame first), and
+  // takeFree skips those.  Guarded by allocMutex.
+  std::vector<int> freeFrames;
+  int   takeFree();              // caller holds allocMutex
+  void  pushFree(const int frame);  // caller holds allocMutex
+
+  void  linkFrame(const int frame, const File* file);    // caller holds allocMutex
+  void  unlinkFrame(const int frame);  // caller holds allocMutex
+  void  noteDirty(const int frame);  // frame pinned or claimed
+  void  waitForIO();             // caller holds allocMutex
+  const Status waitRead(const int frame);  // frame pinned by the caller
+  void  readAhead(File* file, const int pageNo, BufStrategy* strategy);
+
+  void  initEngines(const BufConfig & config);
+
+  // bufPool backing actually obtained, and the length of its mapping
+  // (0 when it is on the heap)
+  BufMemory	 poolMemory;
+  size_t	 poolBytes;
+
+  void  allocPool(const BufConfig & config);
+  void  bindPool(const int nodes);
+  void  freePool();
+
+  // the partition takes bits 32-35 of the hash: the low half of the
+  // product depends on the file pointer alone, and the table index
+  // uses the top bits
+  BufPartition & partitionOf(const File* file, const int pageNo)
+  {
+	return partitions[(BufHashTbl::hashKey(file, pageNo) >> 32) & (BUFPARTITIONS - 1)];
+  }
+
+  // sharding (BufConfig::shards > 1).  The BufMgr the caller made owns
+  // no frames; it routes each page to one of its shards, each a
+  // complete BufMgr with its own frames, page table, replacement policy,
+  // allocMutex and I/O engines.  Its own allocMutex serialises the
+  // operations that change a file's header (allocPage(s), disposePage,
+  // flushFile) across the shards.
+  int		 numShards;
+  BufMgr**	 shards;
+  BufMgr*	 parent;        // for a shard, the BufMgr routing to it
+  int		 shardNo;       // for a shard, its index in parent->shards
+
+  void  initShards(const int bufs, const BufConfig & config);
+  // the shard of (file, pageNo): bits 36 and up of the hash, clear of
+  // those the shard's partitions and tables use
+  int   shardOf(const File* file, const int pageNo) const
   {
-	clockHand = (clockHand + 1) % numBufs;
+	return (int)((BufHashTbl::hashKey(file, pageNo) >> 36) % (uint64_t)numShards);
   }
+  // strategy's ring for shard s
+  BufStrategy* shardStrategy(BufStrategy* strategy, const int s) const;
+
+  // the second half of allocPage, once the file has allocated pageNo:
+  // map it, pinned, into a frame of this BufMgr
+  const Status newFrame(File* file, const int pageNo, Page*& page,
+                        BufStrategy* strategy, const bool zero = false);  // caller holds allocMutex
+  const Status mapNewPage(File* file, const int pageNo, Page*& page,
+                          BufStrategy* strategy, const bool zero = false);
+
+  // flushFiles without the syncs
+  const Status writeFiles(File* const* files, const int count);
+
+  // pin (file,pageNo) if it is resident, setting its reference bit
+  // unless ref is false; returns OK with the frame number, or HASHNOTFOUND
+  Status pinResident(File* file, const int pageNo, int & frame,
+                     const bool ref = true);
+
+  // readPage and unPinPage for a file mapped by File::mapReadOnly:
+  // pages are pinned in place in the mapping, without a frame
+  const Status readMapped(File* file, const int PageNo, Page*& page,
+                          BufStrategy* strategy);
+  const Status unpinMapped(File* file, const int PageNo, const bool dirty);
+
+  // readPage's miss path
+  const Status loadPage(File* file, const int PageNo, Page*& page,
+                        BufStrategy* strategy);
+
+  // allocate a free frame to hold (file, pageNo), from the strategy's
+  // ring if it has a reusable frame
+  const Status allocBuf(int & frame, const File* file, const int pageNo,
+                        BufStrategy* strategy = NULL);
+
+  // background writer: keeps up to bgTargetClean of the frames the
+  // replacement policy will hand out next clean, so that foreground
+  // misses rarely have to write a dirty victim themselves
+  std::thread	 bgWriter;
+  std::mutex	 bgMutex;
+  std::condition_variable bgWake;  // signalled on stop and on foreground writes
+  std::atomic<bool> bgRunning;   // set and cleared under bgMutex, read anywhere
+  bool		 bgStop;
+  int		 bgTargetClean;  // clean reusable frames to keep ready
+  int		 bgMaxWrites;    // most pages written per round
+  int		 bgIntervalMs;   // pause between rounds
+  int*		 bgCandidates;   // scratch for replacer->upcoming()
+  std::atomic<int> bgBusy;       // frames currently claimed by the writer
+
+  void bgWriterLoop();
+  int  bgWriterRound();          // returns pages written
+
+  // write back and unmap the page in a claimed frame; returns OK,
+  // UNIXERR, or PAGEPINNED if somebody pinned or dirtied the page in
+  // the meantime (the claim is then dropped)
+  const Status evictFrame(const int frame);
+  const void releaseBuf(int frame); // return unused frame to end of list
 
 
 public:
   Page*	         bufPool;   // actual buffer pool
 
-  BufMgr(const int bufs);
+  BufMgr(const int bufs, const BufPolicy policy = POLICY_CLOCK);
+  BufMgr(const int bufs, const BufConfig & config);
   ~BufMgr();
 
-  const Status readPage(File* file, const int PageNo, Page*& page);
+  const Status readPage(File* file, const int PageNo, Page*& page,
+                        BufStrategy* strategy = NULL);
   const Status unPinPage(File* file, const int PageNo, const bool dirty);
-  const Status allocPage(File* file, int& PageNo, Page*& page); 
-                        // allocates a new, empty page 
+  const Status allocPage(File* file, int& PageNo, Page*& page,
+                         BufStrategy* strategy = NULL, const int hint = -1); 
+                        // allocates a new, empty page (a free one near
+                        // hint if there is one)
+  const Status allocPages(File* file, const int count, int& firstPageNo,
+                          Page** pages, BufStrategy* strategy = NULL);
+                        // allocates a run of count new pages, all pinned
   const Status flushFile(const File* file); // writing out all dirty pages of the file
+                        // (in one batch through the I/O engine)
+  const Status flushFiles(File* const* files, const int count);
+                        // write the dirty pages of several files in one
+                        // batch sorted by (file, pageNo) and make them
+                        // durable with one fdatasync per file, shared
+                        // with concurrent callers (group commit).  Pages
+                        // stay cached; pinned ones are skipped.
   const Status disposePage(File* file, const int PageNo); // dispose of page in file
+
+  // queue reads of the pages firstPage .. firstPage+count-1 that are
+  // not resident (and exist), into frames obtained as for a miss.  With
+  // io_uring they run asynchronously; the POSIX engine performs them
+  // when the first of them is needed.  The pages are left unpinned in the page table, so the
+  // readPage calls that follow are hits; one that comes before the read
+  // completes waits for it.  A hint: stops quietly when no frame is free.
+  // readPage calls this by itself for files read sequentially.
+  const Status prefetchPages(File* file, const int firstPage, const int count,
+                             BufStrategy* strategy = NULL);
   void  printSelf();
 
-  const BufStats & getBufStats() const // get buffer pool usage
-  {
-	return bufStats;
-  }
-  const void clearBufStats() 
-  {
-	bufStats.clear();
-  }
+  // start the background writer.  Each round it looks at the next
+  // 2 * targetClean frames the replacement policy will hand out and
+  // writes dirty, unpinned ones until targetClean of them are clean or
+  // maxWrites pages were written, then sleeps intervalMs (or until a
+  // foreground miss had to write a dirty victim).  Larger targetClean
+  // and maxWrites, or a shorter interval, make it more aggressive.
+  // Returns BADBUFFER if it is already running.
+  const Status startBgWriter(const int targetClean, const int maxWrites = 64,
+                             const int intervalMs = 20);
+  void  stopBgWriter();
+
+  // backend actually in use (IO_URING falls back to IO_POSIX when the
+  // kernel does not support it)
+  IOEngineKind ioEngineKind() const
+  { return shards ? shards[0]->ioEngineKind() : ioEngine->kind(); }
+
+  // backing of bufPool actually in use (MEM_HUGETLB falls back to
+  // MEM_THP, and either to MEM_HEAP, when the mapping fails)
+  BufMemory memoryKind() const
+  { return shards ? shards[0]->memoryKind() : poolMemory; }
+
+  const BufStats & getBufStats() const; // get buffer pool usage
+  const void clearBufStats();
+
+  // number of shards (1 when the pool is not sharded) and the usage of
+  // one of them; getBufStats is their sum
+  int   getNumShards() const { return numShards; }
+  const BufStats & getShardStats(const int shard) const;
+
+  // entries on the free-frame stack(s), stale ones included; never more
+  // than the number of frames
+  int   getFreeListLength() const;
 };
 
 #endif
@@ -1,10 +1,15 @@
 #ifndef DB_H
 #define DB_H
 
+#include <stdint.h>
 #include <string.h>
 #include <sys/types.h>
 
+#include <atomic>
+#include <condition_variable>
 #include <functional>
+#include <mutex>
+#include <vector>
 
 #include "error.h"
 #include "page.h"
@@ -15,6 +20,40 @@ using namespace std;
 // #define DEBUGIO
 // #define DEBUGFREE
 
+// structure of DB (header) page
+
+typedef struct {
+    int nextFree;   // page # of next page on the (old) linked free list
+    int firstPage;  // page # of first page in file
+    int numPages;   // total # of pages in file
+    int freeMap;    // page # of first free-space map page, 0 if none
+    int pageSize;   // PAGESIZE of the build that created the file; 0 in
+                    // files that predate this field, which used 1024
+} DBPage;
+
+// structure of a free-space map page.  Map page k of the chain starting
+// at DBPage.freeMap covers pages k * FSM_BITS .. (k + 1) * FSM_BITS - 1;
+// a set bit marks a free page.
+
+const int FSM_WORDS = (PAGESIZE - 2 * sizeof(int)) / sizeof(uint64_t);
+const int FSM_BITS = FSM_WORDS * 64;
+
+typedef struct {
+    int next;                   // page # of next map page, 0 at the end
+    int unused;
+    uint64_t words[FSM_WORDS];  // one bit per page, set = free
+} FSMPage;
+
+// the largest buffer alignment O_DIRECT transfers are expected to need.
+// A file uses the alignment the kernel reports for it (statx
+// STATX_DIOALIGN, usually the device's 512-byte logical block) and
+// falls back to this where none is reported.  BufMgr aligns the pool
+// to it, so each frame is aligned to PAGESIZE at least, and a file
+// whose alignment exceeds PAGESIZE stays buffered.  File bounces
+// transfers from other memory that is not aligned through an aligned
+// copy.
+const int DIRECTIO_ALIGN = 4096;
+
 // forward class definition for db
 class DB;
 
@@ -22,15 +61,61 @@ class DB;
 class File {
     friend class DB;
     friend class OpenFileHashTbl;
+    friend class IOEngine;
+    friend class BufMgr;
 
    public:
-    Status allocatePage(int& pageNo);            // allocate a new page
+    Status allocatePage(int& pageNo,
+                        const int hint = -1);    // allocate a new page, reusing
+                                                 // a free one near hint if any
+    const Status allocatePages(const int count,
+                               int& firstPageNo);  // extend file by count pages
     const Status disposePage(const int pageNo);  // release space for a page
     const Status readPage(const int pageNo,
                           Page* pagePtr) const;  // read page from file
     const Status writePage(const int pageNo,
                            const Page* pagePtr);   // write page to file
     const Status getFirstPage(int& pageNo) const;  // returns pageNo of first page
+    const Status getNumPages(int& count) const;    // returns # pages incl. header
+
+    // the file was opened with O_DIRECT (DB::setDirectIO), so page I/O
+    // bypasses the kernel page cache
+    bool directIO() const { return direct; }
+
+    // p can take a page transfer without a bounce copy (always true
+    // unless the file is direct)
+    bool directTarget(const void* p) const
+      { return !direct || ((uintptr_t)p & (dioAlign - 1)) == 0; }
+
+    // map the whole file read-only for scans: BufMgr::readPage then
+    // hands out pointers into the mapping instead of copying pages into
+    // frames, and the file refuses writes, allocations and disposals
+    // until it is closed.  Its pages in the buffer pool are flushed
+    // first (PAGEPINNED if one is pinned).  Call it before other threads
+    // use the file.
+    const Status mapReadOnly();
+    bool isMapped() const { return mapping != NULL; }
+
+    // the header page is cached while the file is open and written back
+    // lazily: by flushHeader() (BufMgr::flushFile calls it), on close,
+    // and, if set, after every `updates' allocations and disposals
+    const Status flushHeader() const;
+    void setHeaderSync(const int updates);
+
+    // write back the header and make every page written so far durable
+    // with fdatasync.  Concurrent callers share syncs (group commit): a
+    // caller waits for the first sync that starts after it called, and
+    // that one sync covers every caller waiting for it.
+    const Status sync();
+    int getSyncCount() const { return syncCount; }  // fdatasyncs issued
+
+    // read / write the run of count pages starting at firstPageNo, one
+    // vectored system call per IOV_MAX pages; pages[i] holds page
+    // firstPageNo + i
+    const Status readPages(const int firstPageNo, const int count,
+                           Page* const* pages) const;
+    const Status writePages(const int firstPageNo, const int count,
+                            Page* const* pages);
 
     bool operator==(const File& other) const {
         return fileName == other.fileName;
@@ -40,16 +125,28 @@ class File {
     File(const string& fname);  // initialize
     ~File();                    // deallocate file object
 
-    static const Status create(const string& fileName);
+    static const Status create(const string& fileName, const bool direct = false);
     static const Status destroy(const string& fileName);
 
-    const Status open();
+    const Status open(const bool direct = false);
     const Status close();
 
     const Status intread(const int pageNo,
                          Page* pagePtr) const;  // internal file read
     const Status intwrite(const int pageNo,
-                          const Page* pagePtr);  // internal file write
+                          const Page* pagePtr) const;  // internal file write
+    const Status intvector(const bool write, const int firstPageNo,
+                           const int count,
+                           Page* const* pages) const;  // internal vectored I/O
+    const Status intflushHeader() const;  // flushHeader, headerMutex held
+    const Status headerChanged();         // mark header dirty, maybe write it
+
+    // free-space map, headerMutex held
+    const Status loadFreeMap();           // read the map chain on open
+    const Status addMapPage();            // append a map page to the chain
+    const Status markFree(const int pageNo);
+    bool isMapPage(const int pageNo) const;
+    bool takeFree(const int hint, int& pageNo);
 
 #ifdef DEBUGFREE
     void listFree();  // list free pages
@@ -58,6 +155,44 @@ class File {
     string fileName;  // The name of the file
     int openCnt;      // # times file has been opened
     int unixFile;     // unix file stream for file
+    bool direct;      // unixFile has O_DIRECT set
+    int dioAlign;     // buffer alignment direct transfers need
+
+    // group commit state for sync(), guarded by syncMutex
+    std::mutex syncMutex;
+    std::condition_variable syncDone;  // a sync finished
+    uint64_t syncTickets;              // sync() calls so far
+    uint64_t syncedTickets;            // calls covered by a completed sync
+    bool syncing;                      // a caller is in fdatasync
+    std::atomic<int> syncCount;
+
+    // read-only mapping (mapReadOnly), NULL if none
+    const char* mapping;
+    int mapPages;                  // pages covered, including the header
+    std::atomic<int>* mapPins;     // pin count of each mapped page
+    std::atomic<bool> mapSequential;  // MADV_SEQUENTIAL is in effect
+    void unmap();
+
+    // cached copy of the header page, guarded by headerMutex
+    DBPage header;
+    mutable bool headerDirty;    // differs from page 0 on disk
+    int headerSync;              // write back every headerSync changes, 0 = lazy
+    mutable int headerUpdates;   // changes since the last write-back
+    mutable std::mutex headerMutex;
+
+    // in-memory copy of the free-space map, also guarded by headerMutex
+    // and written back together with the header
+    std::vector<FSMPage> maps;
+    std::vector<int> mapPageNo;        // where each map page lives
+    mutable std::vector<bool> mapDirty;
+    std::vector<int> mapFree;          // free pages recorded in each map page
+    std::vector<int> mapCursor;        // words below this are all zero
+    int freePages;                     // sum of mapFree
+
+    // sequential read detection, maintained by BufMgr::readPage
+    std::atomic<int> raLast;  // last page read through the buffer pool
+    std::atomic<int> raRun;   // length of the ascending run ending there
+    std::atomic<int> raNext;  // first page not yet read ahead
 };
 
 class BufMgr;
@@ -70,27 +205,37 @@ struct fileHashBucket {
     fileHashBucket* next;  // next node in the hash table
 };
 
+const int FILESLAB = 32;  // fileHashBuckets allocated at a time
+
 // hash table to keep track of open files
 class OpenFileHashTbl {
    private:
     int HTSIZE;
     fileHashBucket** ht;        // actual hash table
-    int hash(string fileName);  // returns value between 0 and HTSIZE-1
+    int hash(const string& fileName);  // returns value between 0 and HTSIZE-1
+
+    // buckets come from slabs of FILESLAB and go back on a free list
+    // (linked through next) when a file is closed, so opening and
+    // closing files does not allocate once the slabs are warm
+    std::vector<fileHashBucket*> slabs;
+    fileHashBucket* freeBuckets;
+    fileHashBucket* newBucket();
+    void freeBucket(fileHashBucket* bucket);
 
    public:
     OpenFileHashTbl();
     ~OpenFileHashTbl();  // destructor
 
     // returns OK if no error occured, HASHTBLERROR if an error occurred
-    Status insert(const string fileName, File* file);
+    Status insert(const string& fileName, File* file);
 
     // see if fileName is already in hash table.  If so a pointer to the file
     // object is returned.
     // returns OK if found. else returns HASHNOTFOUND
-    Status find(const string fileName, File*& file);
+    Status find(const string& fileName, File*& file);
 
     // returns OK if fileName was found.  Else return HASHTBLERROR
-    Status erase(const string fileName);
+    Status erase(const string& fileName);
 };
 
 class DB {
@@ -104,16 +249,17 @@ class DB {
     const Status openFile(const string& fileName, File*& file);  // open a file
     const Status closeFile(File* file);                          // close a file
 
+    // create and open files with O_DIRECT from now on, so that the
+    // buffer pool is the only cache of their pages.  Falls back to
+    // buffered I/O per file where the file system or device does not
+    // support it for PAGESIZE transfers; files already open keep
+    // their mode.
+    void setDirectIO(const bool on) { directIO = on; }
+
    private:
     OpenFileHashTbl openFiles;  // list of open files
+    bool directIO;              // open files with O_DIRECT
 };
 
-// structure of DB (header) page
-
-typedef struct {
-    int nextFree;   // page # of next page on free list
-    int firstPage;  // page # of first page in file
-    int numPages;   // total # of pages in file
-} DBPage;
 
 #endif
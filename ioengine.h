@@ -0,0 +1,149 @@
+#ifndef IOENGINE_H
+#define IOENGINE_H
+
+#include <vector>
+#include "error.h"
+
+class File;
+class Page;
+
+// page I/O backends selectable through BufConfig
+enum IOEngineKind
+{
+  IO_POSIX,   // preadv / pwritev per run of adjacent pages, at reap time
+  IO_URING    // io_uring; falls back to IO_POSIX if the kernel refuses
+};
+
+// one page read or write.  The caller owns the request and must keep it
+// alive until reap() hands it back.
+struct IORequest
+{
+  bool   write;    // true: write page to file, false: read it
+  File*  file;
+  int    pageNo;
+  Page*  page;     // memory to read into / write from
+  Status status;   // set on completion: OK or UNIXERR
+  int    tag;      // caller's cookie (BufMgr uses the frame number)
+};
+
+// Asynchronous page I/O engine.  Requests are queued with prepare(),
+// handed to the kernel in a batch by submit(), and come back through
+// reap().  An engine is not thread-safe; BufMgr gives each thread that
+// does batched I/O its own.
+class IOEngine
+{
+public:
+  virtual ~IOEngine() {}
+
+  // queue a request; it is submitted no later than the next submit()
+  virtual void prepare(IORequest* req) = 0;
+
+  // hand all queued requests to the kernel
+  virtual void submit() = 0;
+
+  // wait until at least minComplete requests (or all in flight, if
+  // fewer) have completed and return up to max of them in done
+  virtual int reap(IORequest** done, const int max, const int minComplete) = 0;
+
+  // number of requests prepared but not yet reaped
+  virtual int pending() const = 0;
+
+  // register [pool, pool + numPages) so I/O into it can skip the
+  // per-request page pinning and mapping; returns UNIXERR if the engine
+  // cannot (the engine then keeps working without it)
+  virtual Status registerBuffers(Page* pool, const int numPages) {
+      (void)pool; (void)numPages;
+      return UNIXERR;
+  }
+
+  virtual IOEngineKind kind() const = 0;
+
+  // create an engine of the given kind with room for depth requests in
+  // flight; IO_URING falls back to IO_POSIX when unavailable
+  static IOEngine* create(const IOEngineKind kind, const int depth);
+
+  // submit requests and wait for all of them; returns the first error
+  Status run(IORequest* reqs, const int count);
+
+protected:
+  static int fileDescriptor(const File* file);
+
+  std::vector<IORequest*> runDone;  // scratch for run()
+};
+
+
+// Performs the queued requests synchronously in reap(), sorted by file
+// and page so that each run of consecutive pages is one vectored system
+// call.  Requests queued together must not touch the same page twice.
+class PosixIOEngine : public IOEngine
+{
+public:
+  void prepare(IORequest* req) { queued.push_back(req); }
+  void submit() {}
+  int  reap(IORequest** done, const int max, const int minComplete);
+  int  pending() const { return (int)queued.size(); }
+  IOEngineKind kind() const { return IO_POSIX; }
+
+private:
+  std::vector<IORequest*> queued;
+  std::vector<Page*> pages;       // scratch for one run, kept to avoid reallocating
+};
+
+
+// Queues one read or write per request in an io_uring; adjacent pages
+// are not coalesced into vectored requests.
+class UringIOEngine : public IOEngine
+{
+public:
+  ~UringIOEngine();
+
+  // returns NULL if io_uring cannot be set up
+  static UringIOEngine* open(const int depth);
+
+  void prepare(IORequest* req);
+  void submit();
+  int  reap(IORequest** done, const int max, const int minComplete);
+  int  pending() const { return inFlight + unsubmitted + (int)completed.size(); }
+  Status registerBuffers(Page* pool, const int numPages);
+  IOEngineKind kind() const { return IO_URING; }
+
+private:
+  UringIOEngine();
+
+  int ringFd;
+  unsigned entries;           // submission queue size
+
+  // submission ring
+  void*     sqRing;
+  size_t    sqRingSize;
+  unsigned* sqHead;
+  unsigned* sqTail;
+  unsigned* sqMask;
+  unsigned* sqArray;
+  void*     sqes;
+  size_t    sqesSize;
+
+  // completion ring
+  void*     cqRing;
+  size_t    cqRingSize;
+  unsigned* cqHead;
+  unsigned* cqTail;
+  unsigned* cqMask;
+  void*     cqes;
+
+  int inFlight;               // submitted, not yet completed
+  int unsubmitted;            // in the SQ, not yet submitted
+
+  // completions collected while making room in the rings, handed out
+  // by the next reap()
+  std::vector<IORequest*> completed;
+
+  // registered buffer pool, if any
+  Page* fixedBase;
+  int   fixedPages;
+  int   pagesPerFixed;        // pages per registered iovec
+
+  int  drain(const int minComplete);  // move CQEs into completed
+};
+
+#endif
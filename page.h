@@ -23,7 +23,17 @@ struct slot_t {
         short	length;  // equals -1 if slot is not in use
 };
 
-const unsigned PAGESIZE = 1024;
+// page size in bytes, fixed at build time (make PAGESIZE=8192).  Files
+// record the size they were created with and are refused by a build
+// with another one.  The slot directory uses shorts, which caps it at
+// 32 KB.
+#ifndef MINIREL_PAGESIZE
+#define MINIREL_PAGESIZE 1024
+#endif
+
+const unsigned PAGESIZE = MINIREL_PAGESIZE;
+static_assert(PAGESIZE >= 512 && PAGESIZE <= 32768 && (PAGESIZE & (PAGESIZE - 1)) == 0,
+              "PAGESIZE must be a power of two between 512 and 32768");
 const unsigned DPFIXED= sizeof(slot_t)+4*sizeof(short)+2*sizeof(int);
 const unsigned PAGEDATASIZE = PAGESIZE-DPFIXED+sizeof(slot_t);
 // size of the data area of a page
@@ -0,0 +1,322 @@
+#ifndef REPLACER_H
+#define REPLACER_H
+
+#include <stdint.h>
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class File;
+class BufDesc;
+
+// buffer replacement policies selectable at BufMgr construction
+enum BufPolicy { POLICY_CLOCK, POLICY_LRUK, POLICY_2Q, POLICY_ARC };
+
+// identity of a disk page, used by policies that remember pages after
+// they have left the pool (LRU-K history, 2Q's A1out, ARC's B1/B2)
+struct BufPageKey
+{
+  const File* file;
+  int pageNo;
+
+  bool operator==(const BufPageKey& other) const {
+      return file == other.file && pageNo == other.pageNo;
+  }
+};
+
+struct BufPageKeyHash
+{
+  size_t operator()(const BufPageKey& key) const;
+};
+
+
+// Free-list arena for the nodes of one or more node-based containers
+// (list, set, unordered_map), so that once warm, loading and evicting
+// pages allocates nothing.  The first single-object allocation fixes
+// the node size; anything else (hash bucket arrays) goes to the heap.
+// Not thread-safe: the containers using an arena share a lock.
+class NodeArena
+{
+public:
+  NodeArena() : size(0), freeNodes(NULL) {}
+  ~NodeArena();
+
+  void* get(size_t bytes);
+  void  put(void* node);
+  bool  serves(size_t bytes) {
+      if (!size)
+          size = bytes;
+      return bytes == size;
+  }
+
+private:
+  size_t size;
+  void*  freeNodes;           // linked through the first word
+  std::vector<char*> slabs;
+
+  NodeArena(const NodeArena&);             // not copyable
+  NodeArena& operator=(const NodeArena&);
+};
+
+const int ARENA_SLAB = 256;   // nodes carved at a time
+
+template <class T>
+struct ArenaAllocator
+{
+  typedef T value_type;
+  NodeArena* arena;
+
+  explicit ArenaAllocator(NodeArena* arena) : arena(arena) {}
+  template <class U>
+  ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+  T* allocate(size_t n) {
+      if (n == 1 && arena->serves(sizeof(T)))
+          return (T*)arena->get(sizeof(T));
+      return (T*)::operator new(n * sizeof(T));
+  }
+  void deallocate(T* p, size_t n) {
+      if (n == 1 && arena->serves(sizeof(T)))
+          arena->put(p);
+      else
+          ::operator delete(p);
+  }
+};
+
+template <class T, class U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.arena == b.arena; }
+template <class T, class U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.arena != b.arena; }
+
+// Interface between BufMgr and a replacement policy.
+//
+// BufMgr reports every page load, hit, unpin and eviction, and asks the
+// policy for a victim when it needs a frame.  pickVictim must return a
+// frame it has claimed (BufDesc::claim); BufMgr then writes it back,
+// unmaps it and calls evicted(), or -- if somebody pinned the page in
+// the meantime -- just releases it again.  Every frame handed out is
+// eventually followed by loaded() or evicted().
+//
+// loaded, pickVictim and evicted are called under BufMgr::allocMutex;
+// accessed and unpinned are called on the hit path, concurrently, for
+// pinned frames, and must do their own locking.
+class BufReplacer
+{
+public:
+  BufReplacer(BufDesc* table, const int numBufs)
+    : bufTable(table), numBufs(numBufs) {}
+  virtual ~BufReplacer() {}
+
+  // (file, pageNo) was read or allocated into frame
+  virtual void loaded(int frame, const File* file, int pageNo) = 0;
+
+  // resident page in frame was pinned by readPage
+  virtual void accessed(int frame) = 0;
+
+  // a pin on frame was dropped.  Called after the unpin, so the frame
+  // may already have been reused; only hints may be updated.
+  virtual void unpinned(int frame) { (void)frame; }
+
+  // choose and claim a victim frame for (file, pageNo); returns -1 if
+  // every frame is pinned
+  virtual int pickVictim(const File* file, int pageNo) = 0;
+
+  // the page in frame left the pool (replaced, flushed or disposed)
+  virtual void evicted(int frame) = 0;
+
+  // fill frames with up to max frames the policy expects to hand out
+  // next, in order, without claiming them; returns how many.  Used by
+  // the background writer to clean victims before they are needed.
+  // Called under BufMgr::allocMutex.
+  virtual int upcoming(int* frames, int max) = 0;
+
+  static BufReplacer* create(BufPolicy policy, BufDesc* table, const int numBufs);
+
+protected:
+  BufDesc* bufTable;
+  int      numBufs;
+
+  // claim frame if it is unpinned (and, with honourRef, not recently
+  // referenced); see BufDesc::claim
+  bool tryClaim(int frame, bool honourRef = false);
+  // clear the frame's reference bit, returning its old value
+  bool clearRef(int frame);
+  bool isValid(int frame);
+  bool isReferenced(int frame);
+  bool isPinned(int frame);   // pinned by a caller, not just claimed
+};
+
+
+// CLOCK: the original second-chance sweep driven by the BUF_REF bit in
+// each frame's state word.  Besides the hand it keeps a bitmap of the
+// frames the sweep found pinned, so that it passes over them 64 at a
+// time; a mark is dropped when a pin on the frame is dropped.  Marks
+// are hints: before reporting every frame pinned, the sweep checks its
+// marks against the frames.  loaded/accessed/evicted are no-ops.
+class ClockReplacer : public BufReplacer
+{
+public:
+  ClockReplacer(BufDesc* table, const int numBufs);
+  ~ClockReplacer();
+
+  void loaded(int, const File*, int) {}
+  void accessed(int) {}
+  void unpinned(int frame);
+  int  pickVictim(const File* file, int pageNo);
+  void evicted(int frame);
+  int  upcoming(int* frames, int max);
+
+private:
+  unsigned int clockHand;
+
+  // bit f of pinnedMarks[f / 64]: frame f was pinned when the sweep
+  // passed it.  The bits past numBufs in the last word are always set.
+  int numWords;
+  std::atomic<uint64_t>* pinnedMarks;
+
+  void markPinned(int frame);
+  // the first frame from frame on (cyclically) that is not marked, and
+  // in skipped the number of marked frames passed over; -1 if every
+  // frame is marked
+  int  nextUnmarked(int frame, int& skipped) const;
+  // drop the marks of frames no longer pinned; returns how many
+  int  verifyMarks();
+};
+
+
+// Common bookkeeping for the list-based policies: the page held by each
+// frame.  Frames that hold nothing are not tracked here; BufMgr hands
+// them out from its free-frame stack before asking for a victim.
+class ListReplacer : public BufReplacer
+{
+public:
+  ListReplacer(BufDesc* table, const int numBufs);
+
+protected:
+  std::mutex lock;                 // guards everything below
+  std::vector<BufPageKey> keys;    // page held by each frame
+  std::vector<bool> resident;      // frame holds a page we track
+  NodeArena frameArena;            // nodes of the subclasses' FrameLists
+
+  typedef std::list<int, ArenaAllocator<int> > FrameList;
+
+  // claim the first frame in list (LRU end first) that is unpinned
+  int claimFrom(const FrameList& list);
+
+  // append up to max - n frames of list (LRU end first) to frames
+  int listFrom(const FrameList& list, int* frames, int n, int max);
+
+  // bounded FIFO of keys of evicted pages
+  struct Ghosts {
+      typedef std::list<BufPageKey, ArenaAllocator<BufPageKey> > KeyList;
+      typedef std::unordered_map<BufPageKey, KeyList::iterator, BufPageKeyHash,
+                                 std::equal_to<BufPageKey>,
+                                 ArenaAllocator<std::pair<const BufPageKey, KeyList::iterator> > > KeyMap;
+
+      NodeArena orderArena, whereArena;
+      KeyList order;
+      KeyMap where;
+      size_t capacity;
+
+      Ghosts();
+      void setCapacity(size_t capacity);
+
+      bool contains(const BufPageKey& key) const { return where.count(key) != 0; }
+      size_t size() const { return order.size(); }
+      // append key, dropping the oldest key if over capacity; returns
+      // true and sets dropped if a key was dropped
+      bool add(const BufPageKey& key, BufPageKey& dropped);
+      void erase(const BufPageKey& key);
+      void trim(size_t size);   // drop oldest keys down to size
+  };
+};
+
+
+// LRU-K with K = 2: evicts the unpinned page whose second most recent
+// reference is oldest; pages referenced only once are evicted first,
+// oldest first.  Reference history is retained for up to numBufs pages
+// after they leave the pool.
+class LRUKReplacer : public ListReplacer
+{
+public:
+  LRUKReplacer(BufDesc* table, const int numBufs);
+
+  void loaded(int frame, const File* file, int pageNo);
+  void accessed(int frame);
+  int  pickVictim(const File* file, int pageNo);
+  void evicted(int frame);
+  int  upcoming(int* frames, int max);
+
+private:
+  struct History { uint64_t last, prev; };  // prev == 0: one reference
+
+  uint64_t now;                      // logical reference clock
+  std::vector<History> history;      // per resident frame
+  typedef std::pair<std::pair<int, uint64_t>, int> Rank;
+  NodeArena orderArena, retainedArena;  // must precede order, retained
+  typedef std::set<Rank, std::less<Rank>, ArenaAllocator<Rank> > RankSet;
+  typedef std::unordered_map<BufPageKey, History, BufPageKeyHash, std::equal_to<BufPageKey>,
+                             ArenaAllocator<std::pair<const BufPageKey, History> > > HistoryMap;
+  RankSet order;                     // eviction order
+
+  HistoryMap retained;
+  Ghosts retainedOrder;              // bounds retained to numBufs pages
+
+  std::pair<int, uint64_t> rank(const History& h) const {
+      return h.prev ? std::make_pair(1, h.prev) : std::make_pair(0, h.last);
+  }
+  void touch(int frame);
+};
+
+
+// 2Q (Johnson & Shasha): first-time pages enter the A1in FIFO; pages
+// referenced again after falling out of A1in (remembered in the ghost
+// queue A1out) are promoted into the Am LRU.
+class TwoQReplacer : public ListReplacer
+{
+public:
+  TwoQReplacer(BufDesc* table, const int numBufs);
+
+  void loaded(int frame, const File* file, int pageNo);
+  void accessed(int frame);
+  int  pickVictim(const File* file, int pageNo);
+  void evicted(int frame);
+  int  upcoming(int* frames, int max);
+
+private:
+  enum { NONE, A1IN, AM };
+  size_t kin;                        // target size of A1in
+  FrameList a1in, am;
+  std::vector<int> queue;            // which list each frame is on
+  std::vector<FrameList::iterator> pos;
+  Ghosts a1out;
+};
+
+
+// ARC (Megiddo & Modha): T1 holds pages seen once recently, T2 pages
+// seen at least twice; ghost lists B1/B2 steer the target size p of T1.
+class ARCReplacer : public ListReplacer
+{
+public:
+  ARCReplacer(BufDesc* table, const int numBufs);
+
+  void loaded(int frame, const File* file, int pageNo);
+  void accessed(int frame);
+  int  pickVictim(const File* file, int pageNo);
+  void evicted(int frame);
+  int  upcoming(int* frames, int max);
+
+private:
+  enum { NONE, T1, T2 };
+  size_t p;                          // target size of T1
+  FrameList t1, t2;
+  std::vector<int> queue;
+  std::vector<FrameList::iterator> pos;
+  Ghosts b1, b2;
+};
+
+#endif